@@ -6,24 +6,40 @@
 #include <functional>
 #include <windows.h>
 #include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <atomic>
 #include "Point.H"
+#include "RingBuffer.H"
+#include "Compositor.H"
 
 using namespace std;
 
 
 class BaseVisualElement{
 public:
+    // With a compositor every element gets its own window so overlaps are resolved in list order,
+    // otherwise it draws straight into a subwindow of the parent
     BaseVisualElement(WINDOW* parentWindow, int x, int y, int width, int height) :
-        subwindow(subwin(parentWindow, height, width, y, x)),
+        subwindow(compositor ? newwin(height, width, y, x) : subwin(parentWindow, height, width, y, x)),
         x(x), y(y), width(width), height(height)
         {
             keypad(subwindow, TRUE); // Enable special keys
         }
     virtual ~BaseVisualElement() { delwin(subwindow); }
 
-    virtual void refresh() { wrefresh(subwindow); }
+    virtual void refresh() {
+        if (compositor) { // The compositor paints the whole screen once per frame instead
+            compositor->noteRefresh(subwindow);
+            return;
+        }
+        wrefresh(subwindow);
+    }
     virtual void draw() { wattroff(subwindow, A_STANDOUT); }
-    void setColor(int foreground, int background) {
+    virtual void setColor(int foreground, int background) {
         init_pair(objectOrder, foreground, background);
         wattron(subwindow, COLOR_PAIR(objectOrder));
         wbkgd(subwindow, COLOR_PAIR(objectOrder)); // Set both text and background color for clarity. You can remove this if needed.
@@ -34,6 +50,11 @@ public:
     virtual void onFocus() { //wattron(subwindow, A_STANDOUT);
     draw(); }
     virtual void onFocusLost() {  }
+    virtual void invalidate() {  } // Window contents were lost, repaint everything on the next draw
+    virtual bool getCursorPosition(int& row, int& col) const { return false; } // Screen position of the text cursor, if any
+
+    // Windows this element paints, in z-order, for the compositor
+    virtual void appendLayers(std::vector<WINDOW*>& layers) { layers.push_back(subwindow); }
 
     int getX() const { return x; }
     int getY() const { return y; }
@@ -43,8 +64,12 @@ public:
 
     WINDOW *subwindow;
     int x, y, width, height;
+
+    static Compositor* compositor; // Optional, replaces per-element wrefresh when set
 };
 
+Compositor* BaseVisualElement::compositor = nullptr;
+
 class BaseVisualElement_Scroller : public BaseVisualElement{
 public:
     BaseVisualElement_Scroller(WINDOW* parentWindow, int x, int y, int width, int height) :
@@ -52,7 +77,7 @@ public:
         {
             // Additional initialization specific to BaseVisualElement_Scroller if needed
         }
-    virtual ~BaseVisualElement_Scroller() { delwin(subwindow); }
+    virtual ~BaseVisualElement_Scroller() {} // Subwindow is released by ~BaseVisualElement
 
 
     // Scroll bar features
@@ -74,7 +99,7 @@ public:
         for(int i = 0; i < height; i++) {
             mvwaddch(subwindow, i, width - 1, (i == verticalScrollPosition ? '#' : '|'));
         }
-        curs_set(0);
+        if (!compositor) curs_set(0); // The compositor owns the cursor when present
     }
     void drawHorizontalScrollbar(){
         int scrollbarWidth = width; // Leave some border
@@ -85,7 +110,7 @@ public:
         for(int i = 0; i < width; i++) {
             mvwaddch(subwindow, height - 1, i, (i == horizontalScrollPosition ? '#' : '-'));
         }
-        curs_set(0);
+        if (!compositor) curs_set(0); // The compositor owns the cursor when present
     }
 };
 
@@ -103,7 +128,7 @@ public:
     virtual void draw() override {
         // No box - just print the text, you can add attributes as needed
         mvwprintw(subwindow, 0, 0, text.c_str());
-        wrefresh(subwindow);
+        refresh();
     }
 
     // Labels typically don't handle input
@@ -188,10 +213,10 @@ public:
                 drawHorizontalScrollbar();
             }
             // Draw the cursor at its current position
-            curs_set(1);
+            if (!compositor) curs_set(1); // The compositor places the cursor from getCursorPosition()
             wmove(subwindow, cursorPos.Y, cursorPos.X);
             mvwchgat(subwindow, cursorPos.Y, cursorPos.X, 1, A_BLINK, 0, NULL);
-            wrefresh(subwindow);
+            refresh();
     }
 
     virtual void handleInput(int input_) override {
@@ -264,6 +289,15 @@ public:
         draw();
     }
 
+    virtual bool getCursorPosition(int& row, int& col) const override {
+        int top, left;
+        getbegyx(subwindow, top, left);
+        getyx(subwindow, row, col);
+        row += top;
+        col += left;
+        return true;
+    }
+
 
 private:
     void moveCursorLeft() {
@@ -412,10 +446,6 @@ public:
         draw();
     }
 
-    virtual void refresh() override {
-        wrefresh(subwindow);
-    }
-
     virtual void draw() override {
         box(subwindow, 0, 0);
         mvwprintw(subwindow, 1, 2, title.c_str());
@@ -470,10 +500,6 @@ public:
             draw();
         }
 
-    virtual void refresh() override {
-        wrefresh(subwindow);
-    }
-
     virtual void draw() override {
         box(subwindow, 0, 0);
         wattrset(subwindow, A_NORMAL);
@@ -541,10 +567,6 @@ public:
         return; // Might change based on other input handling
     }
 
-    virtual void refresh() override {
-        wrefresh(subwindow);
-    }
-
     virtual void draw() override {
         box(subwindow, 0, 0);
         mvwprintw(subwindow, 1, 2, title.c_str());
@@ -575,11 +597,557 @@ private:
     int currentOffset = 0; // Offset for scrolling within the list
 };
 
+///////////////////////////////////////////////////////////////////////////
+// New Sparkline Chart Element
+// Samples can be pushed from a worker thread through a lock-free ring buffer. Each column of
+// the chart is a min/max bucket of samplesPerColumn samples, filled incrementally as samples
+// arrive, and the chart sweeps left to right like a scope. Only columns whose rendered bucket
+// changed since the last draw are repainted.
+class SparklineChart : public BaseVisualElement {
+public:
+    // bufferCapacity should cover the feed rate times the longest gap between draws, with headroom
+    SparklineChart(WINDOW* parentWindow, int samplesPerColumn, size_t bufferCapacity, int x, int y, int width, int height) :
+        BaseVisualElement(parentWindow, x, y, width, height),
+        samples(bufferCapacity),
+        samplesPerColumn(std::max(1, samplesPerColumn)),
+        columns(width),
+        drawnLevels(width)
+    {
+        draw();
+    }
+
+    // Safe to call from one producer thread while the UI thread draws
+    bool pushSample(float value) { return samples.push(value); }
+
+    // Fix the vertical scale. Without a range the chart scales to the visible buckets.
+    void setRange(float low, float high) {
+        autoScale = false;
+        rangeLow = low;
+        rangeHigh = high;
+    }
+
+    void setAutoScale() { autoScale = true; }
+
+    size_t getDroppedSamples() const { return samples.droppedCount(); }
+
+    // Columns whose levels are unchanged are skipped by draw(), so this is only needed
+    // when the window contents were wiped behind the chart's back
+    virtual void invalidate() override {
+        std::fill(drawnLevels.begin(), drawnLevels.end(), Levels{-2, -2});
+    }
+
+    virtual void draw() override {
+        ingest();
+        updateScale();
+        bool repainted = false;
+        for (int col = 0; col < width; ++col) {
+            Levels levels = levelsFor(col);
+            if (levels != drawnLevels[col]) {
+                drawColumn(col, levels);
+                drawnLevels[col] = levels;
+                repainted = true;
+            }
+        }
+        if (repainted) {
+            refresh();
+        }
+    }
+
+    // Charts are display only
+    virtual void handleInput(int input_) override {}
+
+private:
+    struct Bucket {
+        float minValue = 0.0f;
+        float maxValue = 0.0f;
+        int count = 0;
+    };
+
+    // Quantised bottom/top of a column in eighths of a cell, -1 when the column is empty
+    struct Levels {
+        int low = -1;
+        int high = -1;
+        bool operator!=(const Levels& other) const { return low != other.low || high != other.high; }
+    };
+
+    void ingest() {
+        samples.drain([this](float value) {
+            Bucket& bucket = columns[cursorColumn];
+            if (bucket.count == 0) {
+                bucket.minValue = bucket.maxValue = value;
+            } else {
+                bucket.minValue = std::min(bucket.minValue, value);
+                bucket.maxValue = std::max(bucket.maxValue, value);
+            }
+            if (++bucket.count >= samplesPerColumn) {
+                cursorColumn = (cursorColumn + 1) % width;
+                columns[cursorColumn] = Bucket(); // Leave a gap ahead of the sweep
+            }
+        });
+    }
+
+    void updateScale() {
+        if (!autoScale) {
+            return;
+        }
+        bool found = false;
+        float low = 0.0f;
+        float high = 0.0f;
+        for (const Bucket& bucket : columns) {
+            if (bucket.count == 0) {
+                continue;
+            }
+            low = found ? std::min(low, bucket.minValue) : bucket.minValue;
+            high = found ? std::max(high, bucket.maxValue) : bucket.maxValue;
+            found = true;
+        }
+        if (found) {
+            rangeLow = low;
+            rangeHigh = high;
+        }
+    }
+
+    int quantize(float value) const {
+        int maxLevel = height * 8 - 1;
+        if (rangeHigh <= rangeLow) {
+            return 0;
+        }
+        int level = (int)((value - rangeLow) / (rangeHigh - rangeLow) * maxLevel + 0.5f);
+        return std::min(maxLevel, std::max(0, level));
+    }
+
+    Levels levelsFor(int col) const {
+        const Bucket& bucket = columns[col];
+        if (bucket.count == 0) {
+            return Levels();
+        }
+        return Levels{quantize(bucket.minValue), quantize(bucket.maxValue)};
+    }
+
+    void drawColumn(int col, const Levels& levels) {
+#ifdef PDC_WIDE
+        // U+2581..U+2588 lower one-eighth through full block
+        static const chtype lowerBlocks[9] = {' ', 0x2581, 0x2582, 0x2583, 0x2584, 0x2585, 0x2586, 0x2587, 0x2588};
+#else
+        static const chtype lowerBlocks[9] = {' ', '_', '_', '.', '-', '-', '=', '=', '#'};
+#endif
+        int topCell = levels.high / 8;
+        int bottomCell = levels.low / 8;
+        for (int row = 0; row < height; ++row) {
+            chtype glyph = ' ';
+            if (levels.high >= 0 && row <= topCell && row >= bottomCell) {
+                if (row == topCell) {
+                    // When both edges fall in this cell the low edge snaps to the cell bottom
+                    glyph = lowerBlocks[levels.high % 8 + 1];
+                } else if (row == bottomCell && levels.low % 8 > 0) {
+                    // Upper eighths filled: a reversed lower block leaves the bottom low % 8 eighths empty
+                    glyph = lowerBlocks[levels.low % 8] | A_REVERSE;
+                } else {
+                    glyph = lowerBlocks[8];
+                }
+            }
+            mvwaddch(subwindow, height - 1 - row, col, glyph);
+        }
+    }
+
+    RingBuffer<float> samples;
+    int samplesPerColumn;
+    std::vector<Bucket> columns;
+    std::vector<Levels> drawnLevels;
+    int cursorColumn = 0;
+    bool autoScale = true;
+    float rangeLow = 0.0f;
+    float rangeHigh = 0.0f;
+};
+
+///////////////////////////////////////////////////////////////////////////
+// New Screen Container Element
+// Hosts pages behind a row of tabs. A page's elements are built the first time it is shown and
+// hidden pages get no draw or refresh calls. suspendIdlePages() releases the elements of pages
+// that have been hidden for a while; they are rebuilt from the caller's model when shown again.
+class ScreenContainer : public BaseVisualElement {
+public:
+    typedef std::vector<std::unique_ptr<BaseVisualElement>> PageElements;
+
+    ScreenContainer(WINDOW* parentWindow, int x, int y, int width, int height) :
+        BaseVisualElement(parentWindow, x, y, width, height),
+        parentWindow(parentWindow)
+    {
+        draw();
+    }
+
+    // build creates the page's elements on the parent window, below the tab row. save (optional)
+    // runs before a suspended page's elements are destroyed so their state can go back into the model.
+    void addPage(const std::string& title, std::function<void(WINDOW*, PageElements&)> build,
+                 std::function<void(const PageElements&)> save = nullptr) {
+        pages.push_back(Page{title, build, save, PageElements(), false, std::chrono::steady_clock::now(), 0});
+        if (activePage < 0) {
+            showPage(0);
+        } else {
+            draw();
+        }
+    }
+
+    void showPage(int index) {
+        if (index < 0 || index >= (int)pages.size() || index == activePage) {
+            return;
+        }
+        if (activePage >= 0) {
+            pages[activePage].hiddenSince = std::chrono::steady_clock::now();
+        }
+        setFocusedChild(nullptr); // The hidden page's child must drop its focus state
+        activePage = index;
+        werase(subwindow); // Clear what the previous page left behind
+        Page& page = pages[activePage];
+        if (!page.built) {
+            page.build(parentWindow, page.elements);
+            page.built = true;
+            if (hasColor) {
+                applyColor(page.elements);
+            }
+        }
+        for (auto & element : page.elements) {
+            element->invalidate(); // Cleared along with the container when they share its cells
+        }
+        draw(); // Draws and refreshes the container and the page's elements once
+    }
+
+    // Release the elements of every hidden page that has not been shown for maxIdle
+    void suspendIdlePages(std::chrono::steady_clock::duration maxIdle) {
+        auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < (int)pages.size(); ++i) {
+            Page& page = pages[i];
+            if (i == activePage || !page.built || now - page.hiddenSince < maxIdle) {
+                continue;
+            }
+            if (page.save) {
+                page.save(page.elements);
+            }
+            page.elements.clear(); // Deletes the elements and their subwindows
+            page.built = false;
+        }
+    }
+
+    int getActivePage() const { return activePage; }
+    bool isPageBuilt(int index) const { return pages[index].built; }
+
+    // Page elements share the container's colour pair, including pages built later
+    virtual void setColor(int foreground, int background) override {
+        colorForeground = foreground;
+        colorBackground = background;
+        hasColor = true;
+        BaseVisualElement::setColor(foreground, background);
+        for (auto & page : pages) {
+            applyColor(page.elements);
+        }
+    }
+
+    virtual bool getCursorPosition(int& row, int& col) const override {
+        return focusedChild && focusedChild->getCursorPosition(row, col);
+    }
+
+    virtual void draw() override {
+        // Tab row, the active tab is highlighted
+        mvwhline(subwindow, 0, 0, ' ', width);
+        int tabX = 1;
+        for (int i = 0; i < (int)pages.size(); ++i) {
+            pages[i].tabStart = tabX;
+            if (i == activePage) {
+                wattron(subwindow, A_REVERSE);
+            }
+            mvwprintw(subwindow, 0, tabX, pages[i].title.c_str());
+            wattroff(subwindow, A_REVERSE);
+            tabX += pages[i].title.length() + 1;
+        }
+        if (activePage >= 0) {
+            for (auto & element : pages[activePage].elements) {
+                element->draw();
+            }
+        }
+        BaseVisualElement::refresh(); // Page elements refreshed themselves in draw()
+    }
+
+    virtual void refresh() override {
+        BaseVisualElement::refresh();
+        if (activePage >= 0) {
+            for (auto & element : pages[activePage].elements) {
+                element->refresh();
+            }
+        }
+    }
+
+    virtual void appendLayers(std::vector<WINDOW*>& layers) override {
+        layers.push_back(subwindow);
+        if (activePage >= 0) {
+            for (auto & element : pages[activePage].elements) {
+                element->appendLayers(layers);
+            }
+        }
+    }
+
+    virtual void handleInput(int input_) override {
+        if (input_ == KEY_MOUSE) {
+            MEVENT mouseEvent;
+            nc_getmouse(&mouseEvent);
+            if (mouseEvent.y == getY()) {
+                int clickedPage = findClickedTab(mouseEvent.x - getX());
+                if (clickedPage != -1) {
+                    showPage(clickedPage);
+                }
+                return;
+            }
+            if (activePage >= 0) {
+                for (auto & element : pages[activePage].elements) {
+                    if (wenclose(element->subwindow, mouseEvent.y, mouseEvent.x)) {
+                        setFocusedChild(element.get());
+                        focusedChild->handleInput(KEY_MOUSE);
+                        return;
+                    }
+                }
+            }
+            setFocusedChild(nullptr);
+            return;
+        }
+        switch (input_) {
+            case CTL_PGUP:
+                showPage(activePage > 0 ? activePage - 1 : (int)pages.size() - 1);
+                break;
+            case CTL_PGDN:
+                showPage(activePage + 1 < (int)pages.size() ? activePage + 1 : 0);
+                break;
+            default:
+                if (focusedChild) {
+                    focusedChild->handleInput(input_);
+                }
+                break;
+        }
+    }
+
+    virtual void onFocusLost() override {
+        setFocusedChild(nullptr);
+    }
+
+private:
+    struct Page {
+        std::string title;
+        std::function<void(WINDOW*, PageElements&)> build;
+        std::function<void(const PageElements&)> save;
+        PageElements elements;
+        bool built;
+        std::chrono::steady_clock::time_point hiddenSince;
+        int tabStart;
+    };
+
+    void setFocusedChild(BaseVisualElement* child) {
+        if (focusedChild == child) {
+            return;
+        }
+        if (focusedChild) {
+            focusedChild->onFocusLost();
+        }
+        focusedChild = child;
+        if (focusedChild) {
+            focusedChild->onFocus();
+        }
+    }
+
+    void applyColor(PageElements& elements) {
+        for (auto & element : elements) {
+            element->objectOrder = objectOrder;
+            element->setColor(colorForeground, colorBackground);
+        }
+    }
+
+    int findClickedTab(int clickX) {
+        for (int i = 0; i < (int)pages.size(); ++i) {
+            if (clickX >= pages[i].tabStart && clickX < pages[i].tabStart + (int)pages[i].title.length()) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    WINDOW* parentWindow;
+    std::vector<Page> pages;
+    int activePage = -1;
+    BaseVisualElement* focusedChild = nullptr;
+    bool hasColor = false;
+    int colorForeground = COLOR_WHITE;
+    int colorBackground = COLOR_BLACK;
+};
+
 /////////////////////////////////////////////////////////////////
+// Sparkline benchmark
+
+// Feeds the chart from a worker thread at a fixed rate while the UI thread keeps drawing it,
+// then reports how many samples were ingested and how many the ring buffer had to drop.
+static void runSparklineBenchmark(SparklineChart* sparkline, long samplesPerSecond, int seconds, std::ostream& report) {
+    const int batchesPerSecond = 1000;
+    size_t droppedBefore = sparkline->getDroppedSamples();
+    std::atomic<bool> done(false);
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        auto next = start;
+        long sample = 0;
+        for (int batch = 0; batch < seconds * batchesPerSecond; batch++) {
+            for (long i = 0; i < samplesPerSecond / batchesPerSecond; i++, sample++) {
+                sparkline->pushSample((float)std::sin(sample * 0.001));
+            }
+            next += std::chrono::microseconds(1000000 / batchesPerSecond);
+            std::this_thread::sleep_until(next);
+        }
+        done = true;
+    });
+    long draws = 0;
+    while (!done) {
+        sparkline->draw();
+        draws++;
+    }
+    producer.join();
+    sparkline->draw();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long pushed = samplesPerSecond / batchesPerSecond * batchesPerSecond * seconds;
+    size_t dropped = sparkline->getDroppedSamples() - droppedBefore;
+    report << "Samples pushed: " << pushed << " in " << elapsed << " s (" << (long)(pushed / elapsed) << " samples/s)\n";
+    report << "Samples dropped: " << dropped << "\n";
+    report << "Draws:          " << draws << "\n";
+}
+
 /////////////////////////////////////////////////////////////////
+// Compositor helpers
+
+// Layers for the compositor in z-order: the main window first, then elements in list order
+static std::vector<WINDOW*> collectLayers(WINDOW* mainWindow, const std::vector<std::unique_ptr<BaseVisualElement>>& elements) {
+    std::vector<WINDOW*> layers;
+    layers.push_back(mainWindow);
+    for (auto & element : elements) {
+        element->appendLayers(layers);
+    }
+    return layers;
+}
+
+// Compositor that also tallies what the plain wrefresh path would have sent, only used by
+// --bench-compositor. Each refresh is costed the way PDCurses' doupdate emits it: touched lines
+// are diffed against the last screen and every changed run is sent with an absolute cursor move
+// and fresh attributes.
+class BenchmarkCompositor : public Compositor {
+public:
+    BenchmarkCompositor(int rows, int cols) :
+        Compositor(rows, cols),
+        rows(rows), cols(cols),
+        lastScreen(rows * cols, ~(chtype)0),
+        rowBuffer(cols + 1)
+    {
+    }
 
-int main()
+    virtual void noteRefresh(WINDOW* win) override {
+        std::string out;
+        EscapeEncoder encoder(out, cols);
+        encoder.optimiseMotion = false;
+        int top, left, height, width;
+        getbegyx(win, top, left);
+        getmaxyx(win, height, width);
+        int firstCol = std::max(0, left);
+        int lastCol = std::min(cols, left + width);
+        int cursorY, cursorX;
+        getyx(win, cursorY, cursorX);
+        for (int r = 0; r < height; ++r) {
+            int screenRow = top + r;
+            if (!is_linetouched(win, r) || screenRow < 0 || screenRow >= rows || firstCol >= lastCol) {
+                continue;
+            }
+            if (mvwinchnstr(win, r, firstCol - left, rowBuffer.data(), lastCol - firstCol) == ERR) {
+                continue;
+            }
+            chtype* last = &lastScreen[screenRow * cols + firstCol];
+            for (int c = 0; c < lastCol - firstCol; ++c) {
+                if (rowBuffer[c] == last[c]) {
+                    continue;
+                }
+                encoder.reset();
+                encoder.moveTo(screenRow, firstCol + c);
+                for (; c < lastCol - firstCol && rowBuffer[c] != last[c]; ++c) {
+                    encoder.put(rowBuffer[c]);
+                    last[c] = rowBuffer[c];
+                }
+            }
+        }
+        wmove(win, cursorY, cursorX);
+        legacyBytes += out.size();
+        if (!out.empty()) {
+            legacyWrites++;
+        }
+        Compositor::noteRefresh(win);
+    }
+
+    size_t getLegacyBytes() const { return legacyBytes; }
+    size_t getLegacyWrites() const { return legacyWrites; }
+
+private:
+    int rows;
+    int cols;
+    std::vector<chtype> lastScreen;
+    std::vector<chtype> rowBuffer;
+    size_t legacyBytes = 0;
+    size_t legacyWrites = 0;
+};
+
+// Replays typing into a textbox and streaming into a sparkline, then compares the bytes the
+// per-window wrefresh path would send against what the compositor sends for the same frames.
+static void runCompositorBenchmark(BenchmarkCompositor& compositor, WINDOW* mainWindow, std::vector<std::unique_ptr<BaseVisualElement>>& elements,
+                                   TextBox* textbox, SparklineChart* sparkline, int frames, std::ostream& report) {
+    int cursorRow, cursorCol;
+    std::string out;
+    compositor.compose(collectLayers(mainWindow, elements));
+    textbox->getCursorPosition(cursorRow, cursorCol);
+    size_t compositorBytes = compositor.present(out, cursorRow, cursorCol);
+    size_t compositorWrites = 1;
+    for (int frame = 0; frame < frames; frame++) {
+        textbox->handleInput(frame % 15 == 14 ? '\n' : 'a' + frame % 26);
+        textbox->refresh();
+        for (int i = 0; i < 50; i++) {
+            sparkline->pushSample((float)std::sin((frame * 50 + i) * 0.01));
+        }
+        sparkline->draw();
+
+        // Same refresh sequence as the main loop
+        compositor.noteRefresh(mainWindow);
+        for (auto & element : elements) {
+            element->refresh();
+        }
+        compositor.compose(collectLayers(mainWindow, elements));
+        out.clear();
+        textbox->getCursorPosition(cursorRow, cursorCol); // The textbox has focus throughout
+        compositorBytes += compositor.present(out, cursorRow, cursorCol);
+        if (!out.empty()) {
+            compositorWrites++;
+        }
+    }
+    report << "Frames:         " << frames << "\n";
+    report << "wrefresh path:  " << compositor.getLegacyBytes() << " bytes in " << compositor.getLegacyWrites() << " writes\n";
+    report << "Compositor:     " << compositorBytes << " bytes in " << compositorWrites << " writes\n";
+}
+
+/////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////
+
+int main(int argc, char* argv[])
 {
+    // --compositor paints through the Compositor, --bench-compositor prints a byte-count comparison and exits,
+    // --bench-sparkline streams 1M samples/s into the sparkline and reports drops (painting stays off screen)
+    bool useCompositor = false;
+    bool benchCompositor = false;
+    bool benchSparkline = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compositor") == 0) {
+            useCompositor = true;
+        } else if (strcmp(argv[i], "--bench-compositor") == 0) {
+            useCompositor = benchCompositor = true;
+        } else if (strcmp(argv[i], "--bench-sparkline") == 0) {
+            useCompositor = benchSparkline = true;
+        }
+    }
+
     initscr(); // Initialize PDCurses
     cbreak();
 
@@ -592,11 +1160,37 @@ int main()
     chtype ch;
     MEVENT mouseinput;
     keypad(mainWindow, TRUE); // Enable special keys
+
+    // OPTIONAL COMPOSITOR
+    std::unique_ptr<Compositor> compositor;
+    BenchmarkCompositor* benchmarkCompositor = nullptr;
+    if (useCompositor) {
+        if (benchCompositor) {
+            benchmarkCompositor = new BenchmarkCompositor(LINES, COLS);
+            compositor.reset(benchmarkCompositor);
+        } else {
+            compositor.reset(new Compositor(LINES, COLS));
+        }
+        BaseVisualElement::compositor = compositor.get();
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode = 0;
+        GetConsoleMode(console, &mode);
+        SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING); // Let the console interpret escape sequences
+    }
+    auto refreshWindow = [&](WINDOW* win) {
+        if (useCompositor) {
+            compositor->noteRefresh(win);
+        } else {
+            wrefresh(win);
+        }
+    };
+
     box(mainWindow, 0, 0); // Draw a border
-    wrefresh(mainWindow); // Refresh
+    refreshWindow(mainWindow); // Refresh
     start_color();
 
     leaveok(mainWindow, TRUE); // Hide the cursor
+    wtimeout(mainWindow, 50); // Wake up periodically so live elements can redraw
 
     // CREATE MASTER LIST OF ELEMENTS
     std::vector<std::unique_ptr<BaseVisualElement>> elements; // Master list
@@ -605,15 +1199,12 @@ int main()
     // CREATE EXAMPLE ELEMENTS
     std::vector<std::string> options = {"Option 1", "Option 2", "Option 3"};
     SelectionList *selectionlist1 = new SelectionList(mainWindow, "Choose One", options, 5, 10, 20, 10);
-    selectionlist1->subwindow = subwin(mainWindow, selectionlist1->getHeight(), selectionlist1->getWidth(), selectionlist1->getY(), selectionlist1->getX());
 
     // Example label implementation
     Label *label1 = new Label(mainWindow, "Label testing!", 8, 3, 10, 1);
-    label1->subwindow = subwin(mainWindow, label1->getHeight(), label1->getWidth(), label1->getY() , label1->getX() );
 
     // Example button implementation
     Button *button1 = new Button(mainWindow, "Click Me!", 5, 5, 20, 4);
-    button1->subwindow = subwin(mainWindow, button1->getHeight(), button1->getWidth(), button1->getY() , button1->getX() );
     button1->onPress = [&button1]() {
         mvwprintw(button1->subwindow, 1, 1, "Button pressed!"); // call back example
     };
@@ -624,20 +1215,61 @@ int main()
 
     // Example checkbox implementation
     CheckboxList *checkbox1 = new CheckboxList(mainWindow, "options", options, 30, 2, 20, 8);
-    checkbox1->subwindow = subwin(mainWindow, checkbox1->getHeight(), checkbox1->getWidth(), checkbox1->getY(), checkbox1->getX());
 
     // Example textbox implementation
     TextBox *txtbox1 = new TextBox(mainWindow, 50, 5, 20, 10);
-    txtbox1->subwindow = subwin(mainWindow, txtbox1->getHeight(), txtbox1->getWidth(), txtbox1->getY(), txtbox1->getX());
     txtbox1->hasVerticalScrollbar = true;
     txtbox1->hasHorizontalScrollbar = true;
 
+    // Example sparkline implementation, fed from a worker thread. The ring buffer covers the feed rate
+    // times the 50 ms input timeout with plenty of headroom: 1k samples/s normally, 1M samples/s when benchmarking.
+    size_t sparklineCapacity = benchSparkline ? (1 << 17) : 4096;
+    SparklineChart *sparkline1 = new SparklineChart(mainWindow, 100, sparklineCapacity, 50, 16, 20, 4);
+    if (!benchCompositor && !benchSparkline) {
+        std::thread([sparkline1]() {
+            for (int i = 0; ; ++i) {
+                sparkline1->pushSample((float)std::sin(i * 0.01));
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }).detach();
+    }
+
+    // Example screen container implementation, pages are built when first shown
+    ScreenContainer *pages1 = new ScreenContainer(mainWindow, 27, 11, 22, 12);
+    std::vector<std::string> notesModel; // Survives while the Notes page is suspended
+    pages1->addPage("Notes", [&notesModel](WINDOW* parent, ScreenContainer::PageElements& pageElements) {
+        TextBox *notes = new TextBox(parent, 28, 13, 20, 9);
+        if (!notesModel.empty()) {
+            notes->setText(notesModel);
+        }
+        pageElements.push_back(std::unique_ptr<BaseVisualElement>(notes));
+    }, [&notesModel](const ScreenContainer::PageElements& pageElements) {
+        notesModel = static_cast<TextBox*>(pageElements[0].get())->getTextLines();
+    });
+    std::vector<bool> moreOptionsModel(options.size(), false);
+    pages1->addPage("Options", [&](WINDOW* parent, ScreenContainer::PageElements& pageElements) {
+        CheckboxList *moreOptions = new CheckboxList(parent, "More options", options, 28, 13, 20, 6);
+        for (int i = 0; i < (int)moreOptionsModel.size(); i++) {
+            if (moreOptionsModel[i]) {
+                moreOptions->toggleCheckbox(i);
+            }
+        }
+        pageElements.push_back(std::unique_ptr<BaseVisualElement>(moreOptions));
+    }, [&moreOptionsModel](const ScreenContainer::PageElements& pageElements) {
+        moreOptionsModel = static_cast<CheckboxList*>(pageElements[0].get())->getSelectedIndices();
+    });
+    pages1->addPage("About", [](WINDOW* parent, ScreenContainer::PageElements& pageElements) {
+        pageElements.push_back(std::unique_ptr<BaseVisualElement>(new Label(parent, "Built on first show", 28, 13, 20, 1)));
+    });
+
     // PUSH CREATED ELEMENTS TO MASTER LIST
     elements.push_back(std::unique_ptr<BaseVisualElement>(selectionlist1));
     elements.push_back(std::unique_ptr<BaseVisualElement>(button1));
     elements.push_back(std::unique_ptr<BaseVisualElement>(checkbox1));
     elements.push_back(std::unique_ptr<BaseVisualElement>(txtbox1));
     elements.push_back(std::unique_ptr<BaseVisualElement>(label1));
+    elements.push_back(std::unique_ptr<BaseVisualElement>(sparkline1));
+    elements.push_back(std::unique_ptr<BaseVisualElement>(pages1));
 
     int x = 1;
     for (auto & element : elements) {
@@ -647,6 +1279,40 @@ int main()
     }
     selectionlist1->setColor(COLOR_RED, COLOR_WHITE); // Testing coloration of selection list
 
+    if (benchCompositor) {
+        std::ostringstream report;
+        runCompositorBenchmark(*benchmarkCompositor, mainWindow, elements, txtbox1, sparkline1, 120, report);
+        endwin();
+        std::cout << report.str();
+        return 0;
+    }
+    if (benchSparkline) {
+        std::ostringstream report;
+        runSparklineBenchmark(sparkline1, 1000000, 3, report);
+        endwin();
+        std::cout << report.str();
+        return 0;
+    }
+
+    // Paint one frame: either every window through wrefresh or a single composited write
+    auto refreshScreen = [&]() {
+        if (useCompositor) {
+            compositor->compose(collectLayers(mainWindow, elements));
+            int cursorRow = -1, cursorCol = -1;
+            if (focusedElement) {
+                focusedElement->getCursorPosition(cursorRow, cursorCol);
+            }
+            std::string out;
+            compositor->present(out, cursorRow, cursorCol);
+            fwrite(out.data(), 1, out.size(), stdout);
+            fflush(stdout);
+        } else {
+            wrefresh(mainWindow); // Refresh main window to show changes
+            for (auto & element : elements) {
+                element->refresh();
+            }
+        }
+    };
 
     MEVENT event;
     auto isPointInside = [](int clickX, int clickY, int elementX, int elementY, int elementWidth, int elementHeight) {
@@ -677,14 +1343,15 @@ int main()
         }
         if(withinElement == false){
             focusedElement = nullptr;
-            wrefresh(mainWindow); // Refresh main window to show changes
+            refreshWindow(mainWindow); // Refresh main window to show changes
             for (auto & element : elements) {
                 element->draw();
             }
         }
         if (focusedElement && withinElement) {
             // Check if the focused element supports mouse input before dispatching the event
-            if (dynamic_cast<Button*>(focusedElement) || dynamic_cast<CheckboxList*>(focusedElement)) {
+            if (dynamic_cast<Button*>(focusedElement) || dynamic_cast<CheckboxList*>(focusedElement)
+                || dynamic_cast<ScreenContainer*>(focusedElement)) {
                 focusedElement->handleInput(KEY_MOUSE); // Pass mouse event to the focused element
             }
         }
@@ -694,7 +1361,11 @@ int main()
             while(1){
                 ch = wgetch(mainWindow);
                 if(ch == ERR){
-
+                    sparkline1->draw(); // Pick up streamed samples while idle
+                    pages1->suspendIdlePages(std::chrono::seconds(30)); // Release pages hidden for a while
+                    if (useCompositor) {
+                        refreshScreen();
+                    }
                 } else {
 
                     break;
@@ -711,10 +1382,8 @@ int main()
                     focusedElement->refresh();
                 }
             }
-        wrefresh(mainWindow); // Refresh main window to show changes
-        for (auto & element : elements) {
-            element->refresh();
-        }
+        sparkline1->draw(); // Keep draining samples during continuous input too
+        refreshScreen();
 
         }
     endwin(); // End PDCurses